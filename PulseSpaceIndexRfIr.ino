@@ -58,6 +58,10 @@
 #define MIN_PULSE 75 // was 100
 #define MIN_PSCOUNT 48
 #define NODO_DUE
+#define PSI_NOISE // tune pulse limits from the noise floor
+#ifdef __AVR_ATmega328P__
+#define PS_COMPACT // 2KB SRAM: smaller tables, larger psiNibbles
+#endif
 #include "pulsespaceindex.h"
 
 typedef enum {psiNone, psiLoop, psiRf, psiIr} PsiCode;
@@ -129,6 +133,15 @@ void loop()
 	static uint32_t lastSignal = 0;
 //	static uint32_t lastChange = 0;
 
+#ifdef PSI_NOISE
+	if (Serial.available() > 0) {
+		if (Serial.read() == 'c') { // toggle noise calibration, no transmitters around
+			psiNoiseCalibrate(!psiNoiseCalibrating);
+			Serial.println((psiNoiseCalibrating) ? F("Calibrate noise") : F("Calibrate done"));
+		}
+	}
+	psiNoiseTrack();
+#endif
 	if (psCount > 0) {
 		uint32_t uSecs  = micros();
 		if (psCount > lastPsCount) {
@@ -187,17 +200,21 @@ void receiveInterrupt(PsiCode psiCodeP, byte signal)
 
 //		if (fIsRf) {
 			if (signal) {//signal is high, so record low time
-				if (psCount > 0 && pulse_dur < EDGE_TIMEOUT) {
+				if (psCount > 0 && pulse_dur < psiEdgeTimeout()) {
 					psiAddPS(pulse_dur, 0, 1);
 				}
 			}
 			else {  //get here if signal is low, so record high time
-				if (pulse_dur > MIN_PULSE && pulse_dur < MAX_PULSE){
+				if (pulse_dur > psiMinPulse() && pulse_dur < psiMaxPulse()){
 					psiAddPS(pulse_dur, 1, 1);
 				}
-				else if (psCount > 0 && psCount <= 16) {
-					psCount = 0; // reset
-					psiInit();
+				else {
+#ifdef PSI_NOISE
+					psiNoisePulse(pulse_dur);
+#endif
+					if (psCount > 0 && psCount <= psiResetCount()) {
+						psiResetNoise();
+					}
 				}
 			}
 /*
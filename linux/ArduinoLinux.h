@@ -0,0 +1,78 @@
+/*
+ * ArduinoLinux.h
+ *
+ * Minimal Arduino look-alike so pulsespaceindex.h compiles unchanged on a Linux gateway.
+ * Only what pulsespaceindex.h and psid.cpp use: byte, F(), Serial, millis/micros,
+ * noInterrupts/interrupts and max.
+ *
+ * Copyright (c)2011-2018 Rinie Kervel
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __ARDUINOLINUX_H__
+#define __ARDUINOLINUX_H__
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef uint8_t byte;
+
+#define F(s) (s)
+#define DEC 10
+#define HEX 16
+
+template <class T> static inline T max(T a, T b) { return (a > b) ? a : b; }
+template <class T> static inline T min(T a, T b) { return (a < b) ? a : b; }
+
+static inline uint64_t psiMonotonicMicros(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// wrap like the AVR versions do
+static inline uint32_t micros(void) { return (uint32_t)psiMonotonicMicros(); }
+static inline uint32_t millis(void) { return (uint32_t)(psiMonotonicMicros() / 1000); }
+
+// analyzer runs in one thread, nothing to disable
+static inline void noInterrupts(void) {}
+static inline void interrupts(void) {}
+
+class LinuxSerial {
+public:
+	void begin(unsigned long) {}
+	void write(byte c) { putchar(c); }
+	void print(const char *s) { fputs(s, stdout); }
+	void print(char c) { putchar(c); }
+	void print(unsigned long x, int base = DEC) { printf((base == HEX) ? "%lX" : "%lu", x); }
+	void print(unsigned int x, int base = DEC) { print((unsigned long)x, base); }
+	void print(int x, int base = DEC) { if (base == HEX) print((unsigned long)(unsigned int)x, base); else printf("%d", x); }
+	void print(long x, int base = DEC) { if (base == HEX) print((unsigned long)x, base); else printf("%ld", x); }
+	void print(byte x, int base = DEC) { print((unsigned long)x, base); }
+	void println(void) { putchar('\n'); fflush(stdout); }
+	template <class T> void println(T x) { print(x); println(); }
+	template <class T> void println(T x, int base) { print(x, base); println(); }
+};
+
+static LinuxSerial Serial;
+
+#endif // __ARDUINOLINUX_H__
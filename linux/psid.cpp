@@ -0,0 +1,366 @@
+/*
+ * psid.cpp
+ *
+ * PulseSpaceIndex daemon: run the same decoder as the sketch on a Linux gateway.
+ *
+ * Input is either
+ * - a GPIO character device line (-g /dev/gpiochip0 -l 17), edge events with kernel timestamps, or
+ * - "level duration" records from stdin or a named pipe (-f capture.txt), one per line:
+ *     1 350     signal was high (pulse) for 350 us
+ *     0 1050    signal was low (space) for 1050 us
+ *   Lines starting with # are ignored. A duration >= the edge timeout ends the capture just like
+ *   the loop() timeout does on the Arduino.
+ * -c seconds calibrates the noise floor (PSI_NOISE) first, no transmitters should be active.
+ *
+ * A reader thread (SCHED_FIFO for GPIO) only timestamps edges and pushes them into a single producer/single consumer
+ * lock-free ring, the main thread feeds psiAddPS() as receiveInterrupt() does and finishes
+ * a capture on psiNoChangeTimeout() as loop() does.
+ * Per capture latency (last edge to end of psiPrint) is reported on stderr,
+ * stdout gets the same output as the serial port of the sketch.
+ *
+ * Build:
+ *	g++ -O2 -std=c++11 -pthread -o psid linux/psid.cpp
+ *
+ * Copyright (c)2011-2018 Rinie Kervel
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <atomic>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "ArduinoLinux.h"
+
+// same limits as PulseSpaceIndexRfIr.ino
+#define EDGE_TIMEOUT 45000 // was 10000
+#define MAX_PULSE 5000 // was 100
+#define MIN_PULSE 75 // was 100
+#define MIN_PSCOUNT 48
+#define NODO_DUE
+#define PSI_NOISE // tune pulse limits from the noise floor
+#include "../pulsespaceindex.h"
+
+/*
+ * psiEdge: one level with its duration, tUs is monotonic time the level ended
+ */
+typedef struct {
+	uint64_t tUs;
+	uint32_t duration;
+	byte signal; // 1 pulse (high), 0 space (low)
+	byte eof;
+} psiEdge;
+
+/*
+ * Single producer/single consumer ring, power of 2 size.
+ * Reader thread only writes head, analyzer only writes tail.
+ */
+#define PSI_QUEUE_SIZE 4096
+static psiEdge psiQueue[PSI_QUEUE_SIZE];
+static std::atomic<uint32_t> psiQueueHead(0);
+static std::atomic<uint32_t> psiQueueTail(0);
+static std::atomic<uint32_t> psiQueueDropped(0);
+
+static bool psiQueueFull(void) {
+	return psiQueueHead.load(std::memory_order_relaxed) - psiQueueTail.load(std::memory_order_acquire) >= PSI_QUEUE_SIZE;
+}
+
+static bool psiQueuePush(const psiEdge &e) {
+	uint32_t head = psiQueueHead.load(std::memory_order_relaxed);
+	if (head - psiQueueTail.load(std::memory_order_acquire) >= PSI_QUEUE_SIZE) {
+		psiQueueDropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	psiQueue[head & (PSI_QUEUE_SIZE - 1)] = e;
+	psiQueueHead.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+static bool psiQueuePop(psiEdge &e) {
+	uint32_t tail = psiQueueTail.load(std::memory_order_relaxed);
+	if (tail == psiQueueHead.load(std::memory_order_acquire)) {
+		return false;
+	}
+	e = psiQueue[tail & (PSI_QUEUE_SIZE - 1)];
+	psiQueueTail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+static void psiReaderRealtime(void) {
+	struct sched_param sp;
+	memset(&sp, 0, sizeof(sp));
+	sp.sched_priority = sched_get_priority_max(SCHED_FIFO);
+	if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) {
+		fprintf(stderr, "psid: no SCHED_FIFO for reader, running at normal priority\n");
+	}
+}
+
+/*
+ * Wait for room in the queue, sleeps so the analyzer thread always gets to run
+ */
+static void psiQueueWait(void) {
+	while (psiQueueFull()) {
+		usleep(100);
+	}
+}
+
+/*
+ * Reader for "level duration" records (stdin, file or named pipe).
+ * Normal priority: records carry their durations, so timestamps do not need to be exact.
+ */
+static void psiReadRecords(FILE *in) {
+	char line[80];
+	while (fgets(line, sizeof(line), in)) {
+		unsigned int level;
+		unsigned long duration;
+		if ((line[0] == '#') || (sscanf(line, "%u %lu", &level, &duration) != 2)) {
+			continue;
+		}
+		psiEdge e;
+		e.tUs = psiMonotonicMicros();
+		e.duration = (duration > UINT32_MAX) ? UINT32_MAX : (uint32_t)duration;
+		e.signal = level ? 1 : 0;
+		e.eof = 0;
+		psiQueueWait(); // file input can wait, a live pipe should not get here
+		psiQueuePush(e);
+	}
+	psiEdge e = {psiMonotonicMicros(), 0, 0, 1};
+	psiQueueWait();
+	psiQueuePush(e);
+}
+
+/*
+ * Reader for a GPIO character device line, both edges with kernel timestamps.
+ * fActiveLow for a TSOP IR receiver (default high, signal low).
+ */
+static void psiReadGpio(int lineFd, bool fActiveLow) {
+	uint64_t lastNs = 0;
+	struct gpio_v2_line_event ev[16];
+	psiReaderRealtime();
+	for (;;) {
+		ssize_t n = read(lineFd, ev, sizeof(ev));
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("psid: gpio read");
+			break;
+		}
+		for (size_t i = 0; i < n / sizeof(*ev); i++) {
+			uint64_t ns = ev[i].timestamp_ns;
+			if (lastNs) {
+				bool fRising = (ev[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+				psiEdge e;
+				e.tUs = ns / 1000;
+				e.duration = (uint32_t)min<uint64_t>((ns - lastNs) / 1000, UINT32_MAX);
+				e.signal = (fRising == fActiveLow) ? 1 : 0; // level that just ended
+				e.eof = 0;
+				psiQueuePush(e); // never block the edge reader, count drops instead
+			}
+			lastNs = ns;
+		}
+	}
+	psiEdge e = {psiMonotonicMicros(), 0, 0, 1};
+	psiQueueWait();
+	psiQueuePush(e);
+}
+
+static int psiOpenGpio(const char *chip, unsigned int offset, bool fActiveLow) {
+	int chipFd = open(chip, O_RDONLY | O_CLOEXEC);
+	if (chipFd < 0) {
+		perror(chip);
+		return -1;
+	}
+	struct gpio_v2_line_request req;
+	memset(&req, 0, sizeof(req));
+	req.offsets[0] = offset;
+	req.num_lines = 1;
+	req.event_buffer_size = 64;
+	req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+	if (fActiveLow) {
+		req.config.flags |= GPIO_V2_LINE_FLAG_BIAS_PULL_UP; // like digitalWrite(pin, HIGH) in setup()
+	}
+	strncpy(req.consumer, "psid", sizeof(req.consumer) - 1);
+	if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+		perror("psid: GPIO_V2_GET_LINE_IOCTL");
+		close(chipFd);
+		return -1;
+	}
+	close(chipFd);
+	return req.fd;
+}
+
+/*
+ * psiFinishCapture
+ *
+ * Wrap psiFinish() with the loop() summary and latency of the last edge to printed output
+ */
+static void psiFinishCapture(uint64_t lastEdgeUs, uint64_t endUs) {
+	uint16_t count = psCount;
+	uint64_t startUs = psiMonotonicMicros();
+	psiFinish();
+	uint64_t doneUs = psiMonotonicMicros();
+	if (count > 4) {
+		fprintf(stderr, "psid: %s #%u latency %llu us (wait %llu us, analyze %llu us)",
+			(fIsRf) ? "RF" : "IR", count,
+			(unsigned long long)(doneUs - lastEdgeUs),
+			(unsigned long long)(endUs - lastEdgeUs),
+			(unsigned long long)(doneUs - startUs));
+		uint32_t dropped = psiQueueDropped.exchange(0);
+		if (dropped) {
+			fprintf(stderr, " dropped %u", dropped);
+		}
+		fputc('\n', stderr);
+	}
+}
+
+/*
+ * psiReceiveEdge
+ *
+ * receiveInterrupt() for a level that just ended
+ */
+static void psiReceiveEdge(const psiEdge &e) {
+	uint16_t pulse_dur = (e.duration > 0xFFFF) ? 0xFFFF : e.duration;
+	if (!e.signal) { // low time
+		if (psCount > 0 && e.duration < psiEdgeTimeout()) {
+			psiAddPS(pulse_dur, 0, 1);
+		}
+	}
+	else { // high time
+		if (e.duration > psiMinPulse() && e.duration < psiMaxPulse()) {
+			psiAddPS(pulse_dur, 1, 1);
+		}
+		else {
+#ifdef PSI_NOISE
+			psiNoisePulse(pulse_dur);
+#endif
+			if (psCount > 0 && psCount <= psiResetCount()) {
+				psiResetNoise();
+			}
+		}
+	}
+}
+
+static void psiUsage(void) {
+	fprintf(stderr,
+		"usage: psid [-i] [-c seconds] [-f file|-] | [-g /dev/gpiochipN -l offset]\n"
+		"  -f  \"level duration\" records, - or no option for stdin, a named pipe works too\n"
+		"  -g  GPIO character device, -l line offset\n"
+		"  -i  IR receiver (TSOP, default high), RF otherwise\n"
+		"  -c  calibrate noise floor for seconds first\n");
+}
+
+int main(int argc, char *argv[]) {
+	const char *file = NULL;
+	const char *chip = NULL;
+	long offset = -1;
+	long calibrate = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:g:l:c:ih")) != -1) {
+		switch (opt) {
+		case 'f': file = optarg; break;
+		case 'g': chip = optarg; break;
+		case 'l': offset = strtol(optarg, NULL, 0); break;
+		case 'i': fIsRf = false; break;
+		case 'c': calibrate = strtol(optarg, NULL, 0); break;
+		default: psiUsage(); return 1;
+		}
+	}
+
+	psiInit();
+#ifdef JS_OUTPUT
+	Serial.println(F("{ comment:`"));
+#endif
+	Serial.println(F("PulseSpaceIndexRfIr psid!"));
+
+	std::thread reader;
+	if (chip) {
+		if (offset < 0) {
+			psiUsage();
+			return 1;
+		}
+		int lineFd = psiOpenGpio(chip, (unsigned int)offset, !fIsRf);
+		if (lineFd < 0) {
+			return 1;
+		}
+		reader = std::thread(psiReadGpio, lineFd, !fIsRf);
+	}
+	else {
+		FILE *in = stdin;
+		if (file && strcmp(file, "-")) {
+			in = fopen(file, "r");
+			if (!in) {
+				perror(file);
+				return 1;
+			}
+		}
+		reader = std::thread(psiReadRecords, in);
+	}
+
+	// loop(): feed edges, finish on no change timeout
+	uint64_t lastEdgeUs = psiMonotonicMicros();
+#ifdef PSI_NOISE
+	uint64_t calibrateEndUs = lastEdgeUs + (uint64_t)calibrate * 1000000;
+	if (calibrate > 0) {
+		psiNoiseCalibrate(true);
+	}
+#endif
+	for (;;) {
+		psiEdge e;
+#ifdef PSI_NOISE
+		if (psiNoiseCalibrating && (psiMonotonicMicros() >= calibrateEndUs)) {
+			psiNoiseCalibrate(false);
+		}
+		psiNoiseTrack();
+#endif
+		if (psiQueuePop(e)) {
+			if (e.eof) {
+				if (psCount > 0) {
+					psiFinishCapture(lastEdgeUs, e.tUs);
+				}
+				break;
+			}
+			// a level longer than the timeout means loop() would have finished already
+			if ((psCount > 0) && (e.duration >= psiNoChangeTimeout())) {
+				psiFinishCapture(lastEdgeUs, e.tUs);
+			}
+			psiReceiveEdge(e);
+			lastEdgeUs = e.tUs;
+		}
+		else if ((psCount > 0) && (psiMonotonicMicros() - lastEdgeUs >= psiNoChangeTimeout())) {
+			psiFinishCapture(lastEdgeUs, psiMonotonicMicros());
+		}
+		else {
+			usleep(100); // edges queue up meanwhile, ISR timing is kept by the reader
+		}
+	}
+	reader.join();
+	return 0;
+}
@@ -23,8 +23,6 @@
  *   but should be small enough to keep AGC correct.
  * - Few time variations can be stored as index instead of exact timepulse.
  *
- * Change sort to sort merge?
- *
  * Test with
  *	ORSV2
  *		200..1200 split on 700
@@ -114,6 +112,7 @@
  *   { 380, {  1,  6 }, {  1,  3 }, {  3,  1 }, false },    // protocol 4
  *   { 500, {  6, 14 }, {  1,  2 }, {  2,  1 }, false },    // protocol 5
  *   { 450, { 23,  1 }, {  1,  2 }, {  2,  1 }, true }      // protocol 6 (HT6P20B)
+ *   See psiProtocols[] for the matched table (PS_PROTOCOLS).
  *   RKR: OR 450, {1, 23}, {2, 1}, {1, 2} not inverted?
  *   Gap after message > space time  of sync
  *
@@ -152,18 +151,104 @@ byte psMinMaxCount = 0;
 #define JS_OUTPUT	// prepare easy js import
 #define PSI_OVERFLOW 0x0F
 #define PS_MICRO_ELEMENTS 15
-uint psMicroMin[PS_MICRO_ELEMENTS]; // nibble index, 0x0F is overflow so max 15
-uint psMicroMax[PS_MICRO_ELEMENTS]; // nibble index, 0x0F is overflow so max 15
 #include <limits.h>
-ulong psMicroSum[PS_MICRO_ELEMENTS]; // AVG Sum/SumCount
-uint psMicroSumCount[PS_MICRO_ELEMENTS];
-#define PS_MERGE
+#include <stdint.h>
+#include <string.h>
 #undef PS_MERGE_DEBUG
-#define PS_MINDIFF	50 // value for merge
+/*
+ * Bucket per log scaled bin, PS_LOG_SUBBINS per octave (about 19% wide), fixed so independent of arrival order.
+ * psiSortMicroMinMax() splits the bins into buckets on spread (gap) or valleys.
+ */
+#define PS_LOG_SUB_SHIFT 2
+#define PS_LOG_SUBBINS (1 << PS_LOG_SUB_SHIFT)
+#define PS_LOG_BINS ((16 - PS_LOG_SUB_SHIFT + 1) << PS_LOG_SUB_SHIFT) // 16 bit durations
+#define PS_VALLEY 8	// bin with count < 1/PS_VALLEY of bucket peak and rising after it splits
+#define PS_NOSLOT 0x0F	// like PSI_OVERFLOW, never a psBuckets index
+byte psBinSlot[(PS_LOG_BINS + 1) / 2]; // bin -> psBuckets index, a nibble per bin like psiNibbles
+#define psBinSlotShift(bin) (((bin) & 1) << 2)
+#define psBinSlotGet(bin) ((psBinSlot[(bin) >> 1] >> psBinSlotShift(bin)) & 0x0F)
+#define psBinSlotSet(bin, i) (psBinSlot[(bin) >> 1] = (psBinSlot[(bin) >> 1] & (0xF0 >> psBinSlotShift(bin))) | (((i) & 0x0F) << psBinSlotShift(bin)))
+#define PS_CONSENSUS	// vote repeated packages into one
+#define PS_PROTOCOLS	// known protocols first, generic analysis for the rest
 typedef enum {psixPulse, psixSpace, psixPulseSpace, PSIXNRELEMENTS} psiIx; //
-uint psixCount[PS_MICRO_ELEMENTS][PSIXNRELEMENTS]; // index frequency, makes sense to split Pulse/Space to detect signal type...
 
-byte psiNibbles[512]; // psiCount pulseIndex << 4 | spaceIndex
+/*
+ * Bucket statistics: sums of d = (value - ref) >> PS_SUM_SHIFT and d * d, ref is the first value.
+ * Per value only a multiply, mean and variance are divided out at finish.
+ * Sums and count are halved instead of overflowing, mean and variance stay.
+ *
+ * PS_COMPACT: smaller tables for ATmega328 (2KB SRAM), the saved bytes go to psiNibbles
+ * - d in 4 us units, clamped to +-1020 us, 16 bit sums with a byte count
+ * - Byte saturating pulse/space counters
+ * - No min/max, psMicroMin/psMicroMax are mean -/+ 2 sd
+ * - PS_PACKAGES 4 repeated packages for the consensus
+ * psixPulseSpace is always derived from pulse + space
+ */
+//#define PS_COMPACT	// or define before #include
+#ifdef PS_COMPACT
+#define PS_SUM_SHIFT 2	// d in 4 us units
+typedef int16_t psSumD_t;
+typedef uint16_t psSumD2_t;
+typedef byte psSumCount_t;
+#define PS_SUMD_MAX INT16_MAX
+#define PS_SUMD2_MAX UINT16_MAX
+#define PS_SUMCOUNT_MAX UINT8_MAX
+#define PS_D_MAX 255L	// d * d fits psSumD2_t
+typedef byte psCount_t;
+#define PS_COUNT_MAX UINT8_MAX
+#define PS_PACKAGES 4
+#ifndef PSI_NIBBLES	// AVR: old 240 B table + 32 B jData + 512 = 784, now 135 psBuckets, 30 psBinSlot, 17 jData
+#ifdef PSI_NOISE
+#define PSI_NIBBLES 544	// 55 psiNoise
+#else
+#define PSI_NIBBLES 600
+#endif
+#endif
+#else
+#define PS_SUM_SHIFT 0
+typedef long psSumD_t;
+typedef ulong psSumD2_t;
+typedef uint psSumCount_t;
+#define PS_SUMD_MAX LONG_MAX
+#define PS_SUMD2_MAX ULONG_MAX
+#define PS_SUMCOUNT_MAX UINT_MAX
+#define PS_D_MAX 65535L
+typedef uint psCount_t;
+#define PS_COUNT_MAX UINT_MAX
+#define PS_PACKAGES 8
+#ifndef PSI_NIBBLES
+#define PSI_NIBBLES 512
+#endif
+#endif
+#define PS_SPREAD_K 2	// same timing if means closer than PS_SPREAD_K * (sd + sd + jitter floor)
+#define PS_SD_MIN 25	// jitter floor, was PS_MINDIFF 50 for merge
+#define PS_SD_REL 32	// jitter floor is at least mean / PS_SD_REL, sd of a few long gaps says little
+
+typedef struct {
+#ifndef PS_COMPACT
+	uint min; // actual timings
+	uint max;
+#endif
+	uint16_t ref; // first value
+	psSumD_t sumD; // sum of (value - ref) >> PS_SUM_SHIFT
+	psSumD2_t sumD2; // sum of squares
+	psSumCount_t sumCount;
+	psCount_t count[psixPulseSpace]; // index frequency, makes sense to split Pulse/Space to detect signal type...
+} psBucket;
+psBucket psBuckets[PS_MICRO_ELEMENTS]; // nibble index, 0x0F is overflow so max 15
+
+#define psixCount(i, ix) (((ix) < psixPulseSpace) ? psBuckets[(i)].count[(ix)] : (psBuckets[(i)].count[psixPulse] + psBuckets[(i)].count[psixSpace]))
+#define psMicroAvg(i) psBucketMean(&psBuckets[(i)])
+#define psMicroSd(i) psBucketSd(&psBuckets[(i)])
+#ifndef PS_COMPACT
+#define psMicroMin(i) (psBuckets[(i)].min)
+#define psMicroMax(i) (psBuckets[(i)].max)
+#else
+#define psMicroMin(i) psBucketLow(&psBuckets[(i)])
+#define psMicroMax(i) (psMicroAvg(i) + 2 * psMicroSd(i))
+#endif
+
+byte psiNibbles[PSI_NIBBLES]; // psiCount pulseIndex << 4 | spaceIndex
 #define NRELEMENTS(a) (sizeof(a) / sizeof(*(a)))
 
 #define psiNibblePulse(psiNibbles, i) (((psiNibbles)[(i)] >> 4) & 0x0F)
@@ -171,8 +256,9 @@ byte psiNibbles[512]; // psiCount pulseIndex << 4 | spaceIndex
 #define psPulseSpaceNibble(pulse, space) ((((pulse) & 0x0F) << 4) | ((space) & 0x0F))
 #define psiNibblePS(psiNibbles, j) (((j) & 1) ? psiNibbleSpace(psiNibbles, (uint)((j) / 2)) : psiNibblePulse(psiNibbles, (uint)((j) / 2)))
 
-uint jDataStart[8];
-uint jDataEnd[8];
+uint jDataStart[PS_PACKAGES];
+uint jDataEnd[PS_PACKAGES];
+byte jDataCount = 0; // valid jDataStart/jDataEnd packages
 
 static void psiPrintChar(byte S) {
 	Serial.write(S);
@@ -223,63 +309,256 @@ static void psiPrintNumHex(uint x, char c, uint digits) {
 	Serial.print(x,HEX);
 }
 
+static ulong psAbs(long x) {
+	return (x < 0) ? -(ulong)x : (ulong)x;
+}
+
+/*
+ *	psBucketAddSum
+ *
+ * Add value to the bucket mean/variance sums, no division
+ */
+static void psBucketAddSum(psBucket *b, uint value) {
+	long d = ((long)value - (long)b->ref) / (1 << PS_SUM_SHIFT);
+	if (d > PS_D_MAX) {
+		d = PS_D_MAX;
+	}
+	else if (d < -PS_D_MAX) {
+		d = -PS_D_MAX;
+	}
+	ulong d2 = psAbs(d) * psAbs(d);
+	while ((PS_SUMD2_MAX - d2 < b->sumD2) || (b->sumCount >= PS_SUMCOUNT_MAX)
+			|| (psAbs(b->sumD) > PS_SUMD_MAX - psAbs(d))) { // halve
+		b->sumD /= 2;
+		b->sumD2 >>= 1;
+		b->sumCount = (b->sumCount + 1) >> 1;
+	}
+	b->sumD += d;
+	b->sumD2 += d2;
+	b->sumCount += 1;
+}
+
+/*
+ * Mean in us
+ */
+static uint psBucketMean(const psBucket *b) {
+	long sumD = (long)b->sumD * (1 << PS_SUM_SHIFT);
+	long n = b->sumCount;
+	return b->ref + ((sumD < 0) ? (sumD - n / 2) : (sumD + n / 2)) / n;
+}
+
+/*
+ * Variance in (1 << PS_SUM_SHIFT) us units squared
+ */
+static ulong psBucketVar(const psBucket *b) {
+	long meanD = (long)b->sumD / (long)b->sumCount;
+	ulong meanD2 = psAbs(meanD) * psAbs(meanD);
+	ulong ex2 = b->sumD2 / b->sumCount;
+	return (ex2 > meanD2) ? ex2 - meanD2 : 0;
+}
+
+static uint psiSqrt(ulong x) {
+	ulong root = 0;
+	for (ulong bit = 1UL << 30; bit; bit >>= 2) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+	}
+	return (uint)root;
+}
+
+/*
+ * Standard deviation in us
+ */
+static uint psBucketSd(const psBucket *b) {
+	return psiSqrt(psBucketVar(b)) << PS_SUM_SHIFT;
+}
+
+#ifdef PS_COMPACT
+static uint psBucketLow(const psBucket *b) {
+	uint mean = psBucketMean(b);
+	uint sd2 = 2 * psBucketSd(b);
+	return (mean > sd2) ? mean - sd2 : 0;
+}
+#endif
+
+static void psBucketNew(byte i, uint value, byte ix) {
+	psBucket *b = &psBuckets[i];
+#ifndef PS_COMPACT
+	b->min = value;
+	b->max = value;
+#endif
+	b->ref = value;
+	b->sumD = 0;
+	b->sumD2 = 0;
+	b->sumCount = 1;
+	b->count[psixPulse] = 0;
+	b->count[psixSpace] = 0;
+	b->count[ix] = 1;
+}
+
+static void psBucketAdd(byte i, uint value, byte ix) {
+	psBucket *b = &psBuckets[i];
+#ifndef PS_COMPACT
+	if (value < b->min) { // new min
+		b->min = value;
+	}
+	else if (value > b->max) { // new max
+		b->max = value;
+	}
+#endif
+	psBucketAddSum(b, value);
+	if (b->count[ix] < PS_COUNT_MAX) { // saturate
+		b->count[ix]++;
+	}
+}
+
+static ulong psMulSat(ulong a, ulong b) {
+	return (a && (b > ULONG_MAX / a)) ? ULONG_MAX : a * b;
+}
+
+static ulong psAddSat(ulong a, ulong b) {
+	return (ULONG_MAX - a < b) ? ULONG_MAX : a + b;
+}
+
+/*
+ *	psBucketMerge
+ *
+ * Add bucket src to dst, src is not used anymore.
+ * Combined variance n * var = n1 * var1 + n2 * var2 + (mean2 - mean1)^2 * n1 * n2 / n,
+ * stored back with ref on the combined mean. Finish time only.
+ */
+static void psBucketMerge(psBucket *dst, const psBucket *src) {
+	ulong n1 = dst->sumCount;
+	ulong n2 = src->sumCount;
+	long mean1 = psBucketMean(dst);
+	long dm = (long)psBucketMean(src) - mean1;
+	ulong dmUnits = psAbs(dm) >> PS_SUM_SHIFT;
+
+	while (psAbs(dm) * n2 > (ulong)LONG_MAX) { // keep the ratio, lose precision
+		n1 = (n1 + 1) >> 1;
+		n2 = (n2 + 1) >> 1;
+	}
+	ulong n = n1 + n2; // m2 with the same (halved) counts as the scatter term
+	ulong m2 = psAddSat(psMulSat(psBucketVar(dst), n1), psMulSat(psBucketVar(src), n2));
+	ulong scatter = psMulSat(psMulSat(dmUnits * dmUnits, n1), n2); // multiply first, n1 * n2 / n is 0 for single samples
+	m2 = psAddSat(m2, (scatter == ULONG_MAX) ? scatter : scatter / n);
+
+#ifndef PS_COMPACT
+	dst->min = min(dst->min, src->min);
+	dst->max = max(dst->max, src->max);
+#endif
+	dst->ref = mean1 + dm * (long)n2 / (long)n;
+	dst->sumD = 0;
+	while ((m2 > PS_SUMD2_MAX) || (n > PS_SUMCOUNT_MAX)) {
+		m2 >>= 1;
+		n = (n + 1) >> 1;
+	}
+	dst->sumD2 = m2;
+	dst->sumCount = n;
+	for (uint ix = 0; ix < psixPulseSpace; ix++) {
+		dst->count[ix] = (PS_COUNT_MAX - src->count[ix] < dst->count[ix]) ? PS_COUNT_MAX : dst->count[ix] + src->count[ix];
+	}
+}
+
+/*
+ * Means of buckets i < j within PS_SPREAD_K spread, the jitter floor scales with the smaller mean
+ */
+static bool psBucketSame(byte i, byte j) {
+	uint meanI = psMicroAvg(i);
+	uint meanJ = psMicroAvg(j);
+	uint dist = (meanJ > meanI) ? meanJ - meanI : meanI - meanJ;
+	uint floor = max((uint)PS_SD_MIN, (uint)(min(meanI, meanJ) / PS_SD_REL));
+	return (ulong)dist <= (ulong)PS_SPREAD_K * ((ulong)psMicroSd(i) + psMicroSd(j) + floor);
+}
+
+/*
+ *	psLogBin
+ *
+ * Log scaled bin of value, at most 16 shifts
+ */
+static byte psLogBin(uint value) {
+	byte msb = 0;
+	for (uint v = value >> 1; v; v >>= 1) {
+		msb++;
+	}
+	if (msb < PS_LOG_SUB_SHIFT) {
+		return value;
+	}
+	uint bin = ((uint)(msb - PS_LOG_SUB_SHIFT + 1) << PS_LOG_SUB_SHIFT) | ((value >> (msb - PS_LOG_SUB_SHIFT)) & (PS_LOG_SUBBINS - 1));
+	return (bin < PS_LOG_BINS) ? bin : PS_LOG_BINS - 1;
+}
+
+/*
+ *	psiSortMicroMinMax
+ *
+ * Walk the bins in order, so psBuckets come out sorted, and split into buckets on gaps:
+ * mean further than PS_SPREAD_K spread from the bucket so far, or a valley (low count with a higher count after it).
+ * Buckets of one split are merged, psiNibbles is re-indexed once.
+ */
 static void psiSortMicroMinMax() {
 	byte psNewIndex[PS_MICRO_ELEMENTS];
-	uint prevMinVal = 0;
-	uint prevMaxVal = 0;
-	byte jPrev = 0;
-	byte mergeCount = 0;
-
-	// psMicroMin/psMicroMax have actual timings
-	// store sort in psNewIndex
-	for (byte i = 0; i < psMinMaxCount - mergeCount; i++) {
-  	    byte j2=0;
-  	    uint minVal = EDGE_TIMEOUT; // max
-		for (byte j = 0; j < psMinMaxCount; j++) {
-			uint curMinVal = psMicroMin[j];
-			if ((curMinVal < minVal) && (curMinVal > prevMinVal)) {
-				minVal = curMinVal;
-				j2 = j;
-			}
+	byte psHead[PS_MICRO_ELEMENTS]; // first psBuckets index of each new bucket
+	byte newCount = 0;
+	byte prevSlot = PS_NOSLOT;
+	uint prevCount = 0;
+	uint peakCount = 0;
+
+	for (byte i = 0; i < psMinMaxCount; i++) {
+		psNewIndex[i] = PS_NOSLOT;
+	}
+	for (byte bin = 0; bin < PS_LOG_BINS; bin++) {
+		byte i = psBinSlotGet(bin);
+		if ((i == PS_NOSLOT) || (i == prevSlot)) { // empty or overflow bin shared with previous
+			continue;
 		}
-		psNewIndex[j2] = i;
-		prevMaxVal = psMicroMax[j2];
-		prevMinVal = psMicroMin[j2];
-	}
-
-	// swap sort psMicroMin, psMicroMax and psiCount gaat fout op merge!
-	bool fDoneSome;
-	do {
-		fDoneSome = false;
-		for (byte j = 0; j < psMinMaxCount-1; j++) {
-			if (psMicroMin[j] > psMicroMin[j+1]) {
-				uint psMicroMinTemp = psMicroMin[j];
-				psMicroMin[j] = psMicroMin[j+1];
-				psMicroMin[j+1] = psMicroMinTemp;
-
-				uint psMicroMaxTemp = psMicroMax[j];
-				psMicroMax[j] = psMicroMax[j+1];
-				psMicroMax[j+1] = psMicroMaxTemp;
-
-				ulong psMicroSumTemp = psMicroSum[j];
-				psMicroSum[j] = psMicroSum[j+1];
-				psMicroSum[j+1] = psMicroSumTemp;
-
-				uint psMicroSumCountTemp = psMicroSumCount[j];
-				psMicroSumCount[j] = psMicroSumCount[j+1];
-				psMicroSumCount[j+1] = psMicroSumCountTemp;
-
-				// enum {psiPulse, psiSpace, psiPulseSpace, PSINRELEMENTS} psiIx; //
-				for (uint ix = 0; ix < PSIXNRELEMENTS; ix++) {
-					uint psixCountTemp = psixCount[j][ix];
-					psixCount[j][ix] = psixCount[j+1][ix];
-					psixCount[j+1][ix] = psixCountTemp;
-				}
-				fDoneSome = true;
-			}
+		uint count = psixCount(i, psixPulseSpace);
+		if ((prevSlot == PS_NOSLOT) || !psBucketSame(psHead[newCount - 1], i)
+				|| ((prevCount * PS_VALLEY < peakCount) && (count > prevCount))) { // new bucket
+			psHead[newCount++] = i;
+			peakCount = 0;
+		}
+		else {
+			byte head = psHead[newCount - 1];
+#ifdef PS_MERGE_DEBUG
+			Serial.print(F("Merge["));
+			psiPrintComma(psMicroMax(head), ' ', 3);
+			psiPrintComma(psMicroMin(i), ']', 3);
+			psiPrintComma(i, '-', 1);
+			psiPrintComma(head, ' ', 1);
+			Serial.println();
+#endif
+			psBucketMerge(&psBuckets[head], &psBuckets[i]);
+		}
+		psNewIndex[i] = newCount - 1;
+		peakCount = max(peakCount, count);
+		prevCount = count;
+		prevSlot = i;
+	}
+
+	// move heads to 0..newCount-1, psWhere/psAt follow the swaps
+	byte psWhere[PS_MICRO_ELEMENTS];
+	byte psAt[PS_MICRO_ELEMENTS];
+	for (byte i = 0; i < psMinMaxCount; i++) {
+		psWhere[i] = i;
+		psAt[i] = i;
+	}
+	for (byte j = 0; j < newCount; j++) {
+		byte k = psWhere[psHead[j]];
+		if (k != j) {
+			psBucket psBucketTemp = psBuckets[j];
+			psBuckets[j] = psBuckets[k];
+			psBuckets[k] = psBucketTemp;
+			psWhere[psAt[j]] = k;
+			psAt[k] = psAt[j];
+			psWhere[psHead[j]] = j;
+			psAt[j] = psHead[j];
 		}
 	}
-	while (fDoneSome);
 
 	// replace index values
 	for (uint i=0; i < psiCount; i++) {
@@ -289,74 +568,453 @@ static void psiSortMicroMinMax() {
 		space = (space < psMinMaxCount) ? psNewIndex[space] : space;
 		psiNibbles[i] = psPulseSpaceNibble(pulse, space);
 	}
+	psMinMaxCount = newCount;
 }
 
-#ifdef PS_MERGE
+#ifdef PS_CONSENSUS
+/*
+ *	psiConsensusLength
+ *
+ * Longest package in pulse/spaces, packages are aligned on their end gap.
+ * jDataStart + 1 is the end gap of the previous package, so a package is jDataStart + 2 .. jDataEnd
+ */
+static uint psiConsensusLength(void) {
+	uint len = 0;
+	for (byte p = 0; p < jDataCount; p++) {
+		if (jDataEnd[p] - jDataStart[p] - 1 > len) {
+			len = jDataEnd[p] - jDataStart[p] - 1;
+		}
+	}
+	return len;
+}
 
-static void psiMergeMicroMinMax() {
-	byte psNewIndex[PS_MICRO_ELEMENTS];
-	uint prevMinVal = 0;
-	uint prevMaxVal = 0;
-	byte jPrev = 0;
-	byte mergeCount = 0;
-
-	// psMicroMin/psMicroMax have actual timings
-	// store sort in psNewIndex
-	psNewIndex[0] = 0;
-	for (byte i = 1; i < psMinMaxCount; i++) {
-		byte j = i - mergeCount;
-		psNewIndex[i] = j;
-		if (psMicroMin[i] < (psMicroMax[j-1] + PS_MINDIFF)) {
-#ifdef PS_MERGE_DEBUG
-			Serial.print(F("Merge["));
-			psiPrintComma(psMicroMax[j-1], ' ', 3);
-			psiPrintComma(psMicroMin[i], ']', 3);
-			psiPrintComma(i, '-', 1);
-			psiPrintComma(j-1, ' ', 1);
-			Serial.println();
+/*
+ *	psiConsensusPS
+ *
+ * Majority vote of pulse/space index k (0..len-1, len-1 is the end gap) over the repeated packages.
+ * Tie goes to the later package as that one had the AGC tuned.
+ * Returns the index, winCount/voteCount for the confidence.
+ */
+static byte psiConsensusPS(uint k, uint len, byte *winCount, byte *voteCount) {
+	byte votes[PSI_OVERFLOW + 1];
+	byte ps = PSI_OVERFLOW;
+	*winCount = 0;
+	*voteCount = 0;
+	memset(votes, 0, sizeof(votes));
+	for (byte p = 0; p < jDataCount; p++) { // oldest first, >= so the later package wins a tie
+		uint jj = jDataEnd[p] + k + 1; // jDataEnd - (len-1) + k without going negative
+		if ((jj < len) || (jj - len <= jDataStart[p] + 1)) { // before this package
+			continue;
+		}
+		byte v = psiNibblePS(psiNibbles, jj - len);
+		(*voteCount)++;
+		if (++votes[v] >= *winCount) {
+			*winCount = votes[v];
+			ps = v;
+		}
+	}
+	return ps;
+}
+
+/*
+ *	psiPrintConsensus
+ *
+ * Print one repaired package with the confidence (% of votes agreeing) and number of repaired pulse/spaces
+ */
+static void psiPrintConsensus(void) {
+	if (jDataCount < 2) {
+		return;
+	}
+	uint len = psiConsensusLength();
+	ulong wins = 0;
+	ulong votes = 0;
+	uint repaired = 0;
+
+	Serial.print(F("consensus: '"));
+	for (uint k = 0; k < len; k++) {
+		byte winCount, voteCount;
+		byte ps = psiConsensusPS(k, len, &winCount, &voteCount);
+		Serial.print(ps, HEX);
+		wins += winCount;
+		votes += voteCount;
+		if (winCount < voteCount) {
+			repaired++;
+		}
+	}
+	Serial.println(F("',"));
+	Serial.print(F("confidence: "));
+	Serial.print((votes) ? (uint)(wins * 100 / votes) : 0, DEC);
+	psiPrintComma();
+	Serial.print(F("repaired: "));
+	Serial.print(repaired, DEC);
+	psiPrintComma();
+	Serial.print(F("packages: "));
+	Serial.print(jDataCount, DEC);
+	Serial.println(F(","));
+}
 #endif
-			psMicroMax[j-1] = psMicroMax[i];
 
-			// Sum may overflow so check
-			if (ULONG_MAX - psMicroSum[i] > psMicroSum[j-1]) {
-				psMicroSum[j-1] += psMicroSum[i];
-				psMicroSumCount[j-1] += psMicroSumCount[i];
+#ifdef PS_PROTOCOLS
+/*
+ * Known timing families, see RcSwitch timing definitions above.
+ * {pulselength, sync, "0", "1", inverted, encoding}, timings in units of pulselength.
+ * Only used as constant expressions, so the table stays in flash and
+ * psiMatch<P>()/psiDecode<P>() are generated per protocol.
+ * KAKU is RcSwitch protocol 1 (P2S2), KAKUNEW sends a bit as two P1S2 pairs (0 = 01, 1 = 10).
+ * WS249 not yet: encoding unknown.
+ */
+typedef enum {psiPairs, psiPairBits, psiManchester} psiEncoding;
+typedef struct {
+	uint pulseLength;
+	byte sync[2]; // {0, 0} no sync
+	byte zero[2];
+	byte one[2];
+	bool inverted; // first timing is a space
+	psiEncoding encoding;
+} psiProtocol;
+
+static constexpr psiProtocol psiProtocols[] = {
+	{ 350, {  1, 31 }, {  1,  3 }, {  3,  1 }, false, psiPairs },	// protocol 1, KAKU
+	{ 650, {  1, 10 }, {  1,  2 }, {  2,  1 }, false, psiPairs },	// protocol 2
+	{ 100, { 30, 71 }, {  4, 11 }, {  9,  6 }, false, psiPairs },	// protocol 3
+	{ 380, {  1,  6 }, {  1,  3 }, {  3,  1 }, false, psiPairs },	// protocol 4
+	{ 500, {  6, 14 }, {  1,  2 }, {  2,  1 }, false, psiPairs },	// protocol 5
+	{ 450, { 23,  1 }, {  1,  2 }, {  2,  1 }, true,  psiPairs },	// protocol 6 (HT6P20B)
+	{ 275, {  1, 10 }, {  1,  1 }, {  1,  4 }, false, psiPairBits },	// KAKUNEW, start bit T,8T..10T
+	{ 488, {  0,  0 }, {  1,  1 }, {  2,  2 }, false, psiManchester },	// ORSV2, 1024 Hz: T or 2T
+};
+#define PSI_PROTOCOLS NRELEMENTS(psiProtocols)
+#define PSI_NOPROTOCOL 0xFF
+#define PSI_PROTOCOL_MINCOUNT 4	// bucket occurs at least this often to count as data
+#define PSI_PROTOCOL_MINBITS 8
+#define PSI_PROTOCOL_MAXBITS 160	// ORSV2
+
+#define PSI_PROTOCOL_CODE (PSI_PROTOCOL_MAXBITS / 8) // bytes, psUnits and code are on the stack at finish only
+#define PSI_PROTOCOL_VOTES 4	// distinct packages kept for the vote
+
+static constexpr byte psiMin2(byte a, byte b) { return (a < b) ? a : b; }
+static constexpr byte psiMax2(byte a, byte b) { return (a > b) ? a : b; }
+static constexpr byte psiMaxUnits(byte P) {
+	return psiMax2(psiMax2(psiMax2(psiProtocols[P].zero[0], psiProtocols[P].zero[1]), psiMax2(psiProtocols[P].one[0], psiProtocols[P].one[1])),
+		psiMax2(psiProtocols[P].sync[0], psiProtocols[P].sync[1]));
+}
+// psixPulse/psixSpace of the first and second timing of a pair
+static constexpr byte psiFirstIx(byte P) { return (psiProtocols[P].inverted) ? psixSpace : psixPulse; }
+static constexpr byte psiSecondIx(byte P) { return (psiProtocols[P].inverted) ? psixPulse : psixSpace; }
+// shortest data timing as pulse (ix psixPulse) or space
+static constexpr byte psiMinUnits(byte P, byte ix) {
+	return (ix == psiFirstIx(P)) ? psiMin2(psiProtocols[P].zero[0], psiProtocols[P].one[0])
+		: psiMin2(psiProtocols[P].zero[1], psiProtocols[P].one[1]);
+}
+
+/*
+ * OOK receivers make pulses skew us shorter and spaces skew us longer
+ */
+static long psiSkew(long skew, byte ix) {
+	return (ix == psixPulse) ? skew : -skew;
+}
+
+/*
+ * Bucket avg, corrected by skew, within 25% of units * T
+ */
+static bool psiNearUnits(byte i, byte units, uint T, long skew) {
+	long expect = (long)units * T;
+	long avg = (long)psMicroAvg(i) + skew;
+	return (units > 0) && (psAbs(avg - expect) * 4 <= (ulong)expect);
+}
+
+/*
+ * Bucket with avg within 25% of units * T and occurring as ix, PS_MICRO_ELEMENTS if none
+ */
+static byte psiFindUnits(byte units, uint T, long skew, byte ix) {
+	for (byte i = 0; i < psMinMaxCount; i++) {
+		if (psiNearUnits(i, units, T, psiSkew(skew, ix)) && psBuckets[i].count[ix]) {
+			return i;
+		}
+	}
+	return PS_MICRO_ELEMENTS;
+}
+
+/*
+ * Shortest bucket occurring at least PSI_PROTOCOL_MINCOUNT times as ix, psMinMaxCount if none
+ */
+static byte psiShortest(byte ix) {
+	byte i = 0;
+	while ((i < psMinMaxCount) && (psBuckets[i].count[ix] < PSI_PROTOCOL_MINCOUNT)) {
+		i++;
+	}
+	return i;
+}
+
+/*
+ *	psiMatch
+ *
+ * Ratio match of protocol P against the sorted bucket table, fills psUnits (bucket avg in units of pulselength, 0 no match)
+ * T and the pulse/space skew come from the shortest pulse and the shortest space:
+ * pulse = a * T - skew, space = b * T + skew
+ */
+template <byte P> static bool psiMatch(uint &T, byte *psUnits) {
+	constexpr psiProtocol p = psiProtocols[P];
+	constexpr byte a = psiMinUnits(P, psixPulse);
+	constexpr byte b = psiMinUnits(P, psixSpace);
+
+	byte iP = psiShortest(psixPulse);
+	byte iS = psiShortest(psixSpace);
+	if ((iP >= psMinMaxCount) || (iS >= psMinMaxCount)) {
+		return false;
+	}
+	T = ((ulong)psMicroAvg(iP) + psMicroAvg(iS)) / (a + b);
+	long skew = (long)psMicroAvg(iS) - (long)b * T;
+	if ((T * 4 < p.pulseLength * 3) || (T * 4 > p.pulseLength * 5) || (psAbs(skew) * 2 > T)) {
+		return false;
+	}
+	if ((psiFindUnits(p.zero[0], T, skew, psiFirstIx(P)) >= PS_MICRO_ELEMENTS)
+			|| (psiFindUnits(p.zero[1], T, skew, psiSecondIx(P)) >= PS_MICRO_ELEMENTS)
+			|| (psiFindUnits(p.one[0], T, skew, psiFirstIx(P)) >= PS_MICRO_ELEMENTS)
+			|| (psiFindUnits(p.one[1], T, skew, psiSecondIx(P)) >= PS_MICRO_ELEMENTS)) {
+		return false;
+	}
+	if ((p.sync[0] && (psiFindUnits(p.sync[0], T, skew, psiFirstIx(P)) >= PS_MICRO_ELEMENTS))
+			|| (p.sync[1] && (psiFindUnits(p.sync[1], T, skew, psiSecondIx(P)) >= PS_MICRO_ELEMENTS))) {
+		return false;
+	}
+	// every frequent bucket is a protocol timing (same 25% as above) or an end gap: space longer than any timing
+	for (byte i = 0; i < psMinMaxCount; i++) {
+		const byte timings[] = {p.zero[0], p.zero[1], p.one[0], p.one[1], p.sync[0], p.sync[1]};
+		long skewI = psiSkew(skew, (psBuckets[i].count[psixPulse] >= psBuckets[i].count[psixSpace]) ? psixPulse : psixSpace);
+		psUnits[i] = 0;
+		for (byte u = 0; u < NRELEMENTS(timings); u++) {
+			if (psiNearUnits(i, timings[u], T, skewI)) {
+				psUnits[i] = timings[u];
+				break;
 			}
-			else { // improve this!
-				psMicroSum[j-1] = psMicroSum[j-1]/psMicroSumCount[j-1] + psMicroSum[i] / psMicroSumCount[i];
-				psMicroSumCount[j-1] = 1;
+		}
+		if ((psUnits[i] == 0) && (psixCount(i, psixPulseSpace) >= PSI_PROTOCOL_MINCOUNT)
+				&& (psBuckets[i].count[psixPulse] || ((ulong)psMicroAvg(i) * 4 <= (ulong)psiMaxUnits(P) * T * 5))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static byte psiUnits(const byte *psUnits, byte i) {
+	return (i < psMinMaxCount) ? psUnits[i] : 0;
+}
+
+static void psiBitSet(byte *code, uint n, byte bit) {
+	if (bit) {
+		code[n / 8] |= 0x80 >> (n % 8);
+	}
+	else {
+		code[n / 8] &= ~(0x80 >> (n % 8));
+	}
+}
+
+/*
+ * Distinct decoded packages with their counts, the most frequent one is printed
+ * More than PSI_PROTOCOL_VOTES distinct packages: the others are not counted
+ */
+typedef struct {
+	byte code[PSI_PROTOCOL_VOTES][PSI_PROTOCOL_CODE];
+	uint bits[PSI_PROTOCOL_VOTES];
+	byte count[PSI_PROTOCOL_VOTES];
+	byte used;
+} psiVotes;
+
+static bool psiCodeSame(const byte *a, const byte *b, uint bits) {
+	return !memcmp(a, b, (bits + 7) / 8 - 1)
+		&& ((a[(bits - 1) / 8] ^ b[(bits - 1) / 8]) & (0xFF00 >> (((bits - 1) % 8) + 1))) == 0;
+}
+
+/*
+ * Package of bits complete, vote for it
+ */
+static void psiPackage(const byte *code, uint bits, psiVotes &votes) {
+	if (bits < PSI_PROTOCOL_MINBITS) {
+		return;
+	}
+	for (byte v = 0; v < votes.used; v++) {
+		if ((votes.bits[v] == bits) && psiCodeSame(votes.code[v], code, bits)) {
+			if (votes.count[v] < UINT8_MAX) {
+				votes.count[v]++;
 			}
-			// enum {psiPulse, psiSpace, psiPulseSpace, PSINRELEMENTS} psiIx; //
-			for (uint ix = 0; ix < PSIXNRELEMENTS; ix++) {
-				psixCount[j-1][ix] += psixCount[i][ix];
+			return;
+		}
+	}
+	if (votes.used < PSI_PROTOCOL_VOTES) {
+		memcpy(votes.code[votes.used], code, PSI_PROTOCOL_CODE);
+		votes.bits[votes.used] = bits;
+		votes.count[votes.used] = 1;
+		votes.used++;
+	}
+}
+
+/*
+ * Most frequent package, longer on a tie. confidence: % of the packages of that length agreeing
+ */
+static byte psiVoteWinner(const psiVotes &votes, byte &confidence) {
+	byte best = 0;
+	for (byte v = 1; v < votes.used; v++) {
+		if ((votes.count[v] > votes.count[best])
+				|| ((votes.count[v] == votes.count[best]) && (votes.bits[v] > votes.bits[best]))) {
+			best = v;
+		}
+	}
+	uint total = 0;
+	for (byte v = 0; v < votes.used; v++) {
+		if (votes.bits[v] == votes.bits[best]) {
+			total += votes.count[v];
+		}
+	}
+	confidence = (uint)votes.count[best] * 100 / total;
+	return best;
+}
+
+/*
+ *	psiDecode
+ *
+ * Bit decoder of protocol P: pulse/space pairs or Manchester half bits.
+ * Only a hit when at least 3/4 of the pulse/spaces decode, prints the package most repeats agree on.
+ */
+template <byte P> static bool psiDecode(uint T, const byte *psUnits) {
+	constexpr psiProtocol p = psiProtocols[P];
+	byte code[PSI_PROTOCOL_CODE] = {0};
+	psiVotes votes;
+	votes.used = 0;
+	uint bits = 0;
+	uint decoded = 0; // pulse/spaces in bits
+
+	if (p.encoding != psiManchester) {
+		byte pending = 2; // psiPairBits: first pair bit, 2 none
+		for (uint k = 0; k + p.inverted < psiCount; k++) {
+			byte u0 = (p.inverted) ? psiUnits(psUnits, psiNibbleSpace(psiNibbles, k)) : psiUnits(psUnits, psiNibblePulse(psiNibbles, k));
+			byte u1 = (p.inverted) ? psiUnits(psUnits, psiNibblePulse(psiNibbles, k + 1)) : psiUnits(psUnits, psiNibbleSpace(psiNibbles, k));
+			byte bit = ((u0 == p.zero[0]) && (u1 == p.zero[1])) ? 0 : (((u0 == p.one[0]) && (u1 == p.one[1])) ? 1 : 2);
+			if (p.encoding == psiPairBits) { // 01 is 0, 10 is 1
+				if ((bit < 2) && (pending == 2)) {
+					pending = bit;
+					continue;
+				}
+				if ((bit < 2) && (bit != pending)) {
+					decoded += 2; // first pair
+					bit = pending;
+				}
+				else {
+					bit = 2;
+				}
+				pending = 2;
+			}
+			if ((bit < 2) && (bits < PSI_PROTOCOL_MAXBITS)) {
+				psiBitSet(code, bits++, bit);
+				decoded += 2;
+			}
+			else { // sync, gap or garbled: end of package
+				psiPackage(code, bits, votes);
+				bits = 0;
 			}
-			psNewIndex[i] = j-1;
-			mergeCount++;
-		}
-		else if (j < i) {
-			psMicroMin[j] = psMicroMin[i];
-			psMicroMax[j] = psMicroMax[i];
-
-			psMicroSum[j] = psMicroSum[i];
-			psMicroSumCount[j] = psMicroSumCount[i];
-			// enum {psiPulse, psiSpace, psiPulseSpace, PSINRELEMENTS} psiIx; //
-			for (uint ix = 0; ix < PSIXNRELEMENTS; ix++) {
-				psixCount[j][ix] = psixCount[i][ix];
+		}
+	}
+	else { // Manchester: levels of 1 or 2 half bits, rising edge in the middle is 1
+		byte pending = 2; // first half bit level, 2 none
+		uint halvesBits = 0; // half bits in bits
+		uint halvesTotal = 0;
+		for (uint j = 0; j < psiCount * 2; j++) {
+			byte level = (j & 1) ? 0 : 1;
+			byte halves = psiUnits(psUnits, psiNibblePS(psiNibbles, j));
+			if ((halves != p.zero[0]) && (halves != p.one[0])) { // gap or garbled
+				psiPackage(code, bits, votes);
+				bits = 0;
+				pending = 2;
+				continue;
+			}
+			halvesTotal += halves;
+			for (byte h = 0; h < halves; h++) {
+				if (pending == 2) {
+					pending = level;
+				}
+				else if ((pending != level) && (bits < PSI_PROTOCOL_MAXBITS)) {
+					psiBitSet(code, bits++, level);
+					halvesBits += 2;
+					pending = 2;
+				}
+				else { // out of phase, resync on this half bit
+					pending = level;
+				}
 			}
 		}
+		decoded = (halvesTotal) ? (ulong)psiCount * 2 * halvesBits / halvesTotal : 0;
+	}
+	psiPackage(code, bits, votes);
+	if (!votes.used || (decoded * 4 < psiCount * 2 * 3)) {
+		return false;
+	}
+	byte confidence;
+	byte best = psiVoteWinner(votes, confidence);
+
+	psiPrintChar('{');
+	Serial.println();
+	Serial.print((fIsRf) ? F("RF protocol "): F("IR protocol "));
+	Serial.print(P + 1, DEC);
+	psiPrintChar(':');
+	Serial.println();
+#ifdef JS_OUTPUT
+	Serial.println(F("`,"));
+#endif
+	Serial.print(F("protocol: "));
+	Serial.print(P + 1, DEC);
+	psiPrintComma();
+	Serial.print(F("pulse: "));
+	Serial.print(T, DEC);
+	psiPrintComma();
+	Serial.print(F("bits: "));
+	Serial.print(votes.bits[best], DEC);
+	psiPrintComma();
+	Serial.print(F("repeats: "));
+	Serial.print(votes.count[best], DEC);
+	psiPrintComma();
+	Serial.print(F("confidence: "));
+	Serial.print(confidence, DEC);
+	psiPrintComma();
+	Serial.print(F("code: '"));
+	for (uint n = 0; n < votes.bits[best]; n++) {
+		psiPrintChar((votes.code[best][n / 8] & (0x80 >> (n % 8))) ? '1' : '0');
 	}
+	Serial.println(F("',"));
+	Serial.println(F("},"));
+#ifdef JS_OUTPUT
+	Serial.println(F("{ comment:`"));
+#endif
+	return true;
+}
 
-	if (mergeCount > 0) {
-		// replace index values
-		for (uint i=0; i < psiCount; i++) {
-			byte pulse = psiNibblePulse(psiNibbles, i);
-			byte space = psiNibbleSpace(psiNibbles, i);
-			pulse = (pulse < psMinMaxCount) ? psNewIndex[pulse] : pulse;
-			space = (space < psMinMaxCount) ? psNewIndex[space] : space;
-			psiNibbles[i] = psPulseSpaceNibble(pulse, space);
+/*
+ * Try protocols in table order, first hit decodes
+ */
+template <byte P> struct psiProtocolBank {
+	static byte matchDecode(void) {
+		uint T;
+		byte psUnits[PS_MICRO_ELEMENTS];
+		if (psiMatch<P>(T, psUnits) && psiDecode<P>(T, psUnits)) {
+			return P;
 		}
-		psMinMaxCount -= mergeCount;
+		return psiProtocolBank<P + 1>::matchDecode();
+	}
+};
+
+template <> struct psiProtocolBank<PSI_PROTOCOLS> {
+	static byte matchDecode(void) {
+		return PSI_NOPROTOCOL;
 	}
+};
+
+/*
+ *	psiMatchProtocol
+ *
+ * Call after psiSortMicroMinMax(), returns protocol index or PSI_NOPROTOCOL for generic analysis
+ * Table has RF protocols only.
+ */
+byte psiMatchProtocol(void) {
+	return (fIsRf) ? psiProtocolBank<0>::matchDecode() : PSI_NOPROTOCOL;
 }
 #endif
 
@@ -376,12 +1034,12 @@ void psiPrint() {
 	for (uint ix = 0; ix < PSIXNRELEMENTS; ix++) {
 		// init DataShort/DataLong with 0 and 1 but for psixPulseSpace with max individual values
 		psiDataShort[ix] = (ix < psixPulseSpace) ? 0 : max(psiDataShort[psixPulse], psiDataShort[psixSpace]);
-		psiCountDataShort[ix] = psixCount[psiDataShort[ix]][ix];
+		psiCountDataShort[ix] = psixCount(psiDataShort[ix], ix);
 		psiDataLong[ix] = (ix < psixPulseSpace) ? 1 : max(psiDataLong[psixPulse], psiDataLong[psixSpace]);
-		psiCountDataLong[ix] = psixCount[psiDataLong[ix]][ix];
+		psiCountDataLong[ix] = psixCount(psiDataLong[ix], ix);
 		psiCountGapMax = 0;
 		for (uint i = psiDataLong[ix] + 1; i < psMinMaxCount; i++) {
-			uint psiCount = psixCount[i][ix];
+			uint psiCount = psixCount(i, ix);
 			if (psiCount > psiCountDataLong[ix]) { // new 1st max frequency, new long
 				if (psiCountDataLong[ix] > psiCountDataShort[ix]) { // Old Long -> new Short only if occurs more
 					psiDataShort[ix] = psiDataLong[ix];
@@ -406,7 +1064,7 @@ void psiPrint() {
 		if (ix < psixPulseSpace) {
 			psiCountData[ix] = 0;
 			for (uint i=0; i < psMinMaxCount; i++) {
-				uint psiCount = psixCount[i][ix];
+				uint psiCount = psixCount(i, ix);
 				if (psiCount > psiCountDataMin) {
 					psiCountData[ix] += 1;
 				}
@@ -426,6 +1084,15 @@ void psiPrint() {
 				psiCountData[ix] = 1;
 		}
 	}
+	// first GAP index: further than PS_SPREAD_K spread from Long
+	uint psiGapIndex[PSIXNRELEMENTS];
+	for (uint ix = 0; ix < PSIXNRELEMENTS; ix++) {
+		uint g = psiDataLong[ix] + 1;
+		while ((g < psMinMaxCount) && psBucketSame(psiDataLong[ix], g)) {
+			g++;
+		}
+		psiGapIndex[ix] = g;
+	}
 	uint j = 0;
 
 #if 1
@@ -439,7 +1106,7 @@ void psiPrint() {
 //	uint jPreStart, jStart, jEnd;
 	uint jMatchCount = 0; // likely number of packages
 	uint jDataMax = 0;
-	uint jDataCount = 0;
+	jDataCount = 0;
 	uint jMax = (fIsRf) ? 16 : 4; // min package length
 	for (uint i=0; i < psiCount; i++, j++) {
 		byte pulse = psiNibblePulse(psiNibbles, i);
@@ -448,7 +1115,7 @@ void psiPrint() {
 		for (uint ix = 0; ix < PSIXNRELEMENTS-1; ix++) {
 			byte ps = (ix == psixPulse) ? pulse : space;
 
-			if (ps > psiDataLong[ix]) { // GAP (no data)
+			if (ps >= psiGapIndex[ix]) { // GAP (no data)
 				uint jj = j * 2 + ix;
 				if (jj > jMax) {
 					if (jj > jMax + 4) { // start/end of package may be garbled so allow 4 tolerance
@@ -497,46 +1164,55 @@ void psiPrint() {
 	// prepare for js analysis
 //	Serial.println();
 	Serial.print(F("minMicro: ["));
-	psiPrintComma(psMicroMin[0], 0, 3, psMicroMax[0]);
+	psiPrintComma(psMicroMin(0), 0, 3, psMicroMax(0));
 	for (uint i=1; i < psMinMaxCount; i++) {
-		psiPrintComma(psMicroMin[i], ',', 3, psMicroMax[i]);
+		psiPrintComma(psMicroMin(i), ',', 3, psMicroMax(i));
 	}
 	Serial.println(F("],"));
 
 	Serial.print(F("maxMicro: ["));
-	psiPrintComma(psMicroMax[0], 0, 3, psMicroMax[0]);
+	psiPrintComma(psMicroMax(0), 0, 3, psMicroMax(0));
 	for (uint i=1; i < psMinMaxCount; i++) {
-		psiPrintComma(psMicroMax[i], ',', 3, psMicroMax[i]);
+		psiPrintComma(psMicroMax(i), ',', 3, psMicroMax(i));
 	}
 	Serial.println(F("],"));
 
 	Serial.print(F("avgMicro: ["));
-	psiPrintComma(psMicroSum[0] / psMicroSumCount[0] , 0, 3, psMicroMax[0]);
+	psiPrintComma(psMicroAvg(0), 0, 3, psMicroMax(0));
 	for (uint i=1; i < psMinMaxCount; i++) {
-		psiPrintComma(psMicroSum[i] / psMicroSumCount[i] , ',', 3, psMicroMax[i]);
+		psiPrintComma(psMicroAvg(i), ',', 3, psMicroMax(i));
+	}
+	Serial.println(F("],"));
+	Serial.print(F("sdMicro:  ["));
+	psiPrintComma(psMicroSd(0), 0, 3, psMicroMax(0));
+	for (uint i=1; i < psMinMaxCount; i++) {
+		psiPrintComma(psMicroSd(i), ',', 3, psMicroMax(i));
 	}
 	Serial.println(F("],"));
 	Serial.print(F("Index:    ["));
-	psiPrintComma(0, 0, 3, psMicroMax[0]);
+	psiPrintComma(0, 0, 3, psMicroMax(0));
 	for (uint i=1; i < psMinMaxCount; i++) {
-		psiPrintComma(i , ',', 3, psMicroMax[i]);
+		psiPrintComma(i , ',', 3, psMicroMax(i));
 	}
 	Serial.println(F("],"));
 
 #if 1	// pulseCount and spaceCount
 	Serial.print(F("pulseCnt: ["));
-	psiPrintComma(psixCount[0][psixPulse], 0, 3, psMicroMax[0]);
+	psiPrintComma(psixCount(0, psixPulse), 0, 3, psMicroMax(0));
 	for (uint i=1; i < psMinMaxCount; i++) {
-			psiPrintComma(psixCount[i][psixPulse], ',', 3, psMicroMax[i]);
+			psiPrintComma(psixCount(i, psixPulse), ',', 3, psMicroMax(i));
 	}
 	Serial.println(F("],"));
 
 	Serial.print(F("spaceCnt: ["));
-	psiPrintComma(psixCount[0][psixSpace], 0, 3, psMicroMax[0]);
+	psiPrintComma(psixCount(0, psixSpace), 0, 3, psMicroMax(0));
 	for (uint i=1; i < psMinMaxCount; i++) {
-			psiPrintComma(psixCount[i][psixSpace], ',', 3, psMicroMax[i]);
+			psiPrintComma(psixCount(i, psixSpace), ',', 3, psMicroMax(i));
 	}
 	Serial.println(F("],"));
+#endif
+#ifdef PS_CONSENSUS
+	psiPrintConsensus();
 #endif
 	Serial.print(F("ps: "));
 	Serial.println();
@@ -553,7 +1229,7 @@ void psiPrint() {
 		space = ((psiCountData[psixSpace] == 2) && (space <= psiDataShort[psixSpace]))
 			? 0 : ((space <= psiDataLong[psixSpace]) ? 1 : space);
 #endif
-		if ((pulse > psiDataLong[psixPulse]) && ((j > 16))) { // sync pulse
+		if ((pulse >= psiGapIndex[psixPulse]) && ((j > 16))) { // sync pulse
 #ifndef JS_OUTPUT
 			Serial.println();
 #else
@@ -564,7 +1240,7 @@ void psiPrint() {
 		}
 		Serial.print(pulse,HEX);
 		Serial.print(space,HEX);
-		if ((space > psiDataLong[psixSpace]) && ((j > 16))) { // long gap
+		if ((space >= psiGapIndex[psixSpace]) && ((j > 16))) { // long gap
 #ifndef JS_OUTPUT
 			Serial.println();
 #else
@@ -588,110 +1264,43 @@ void psiPrint() {
 void psiInit(void) {
 	psMinMaxCount = 0;
 	psiCount = 0;
+	memset(psBinSlot, (PS_NOSLOT << 4) | PS_NOSLOT, sizeof(psBinSlot));
 }
 
 /*
  *	psNibbleIndex
  *
- * Lookup/Store timing of pulse and space in psMicroMin/psMicroMax/psiCount array
+ * Lookup/Store timing of pulse and space in psBuckets array, one bucket per log bin.
  * Could use seperate arrays for pulses and spaces but 15 (0x0F for overflow) seems enough
+ * More than 15 bins: share an adjacent used bin, further away is PSI_OVERFLOW like before log bins.
  */
 static byte psNibbleIndex(uint pulse, uint space) {
 	byte psNibble = 0;
 	uint value = pulse; // pulse, then space...
 	for (int j = 0; j < 2; j++) {
-		int i = 0;
+		byte i = PSI_OVERFLOW;
 		if (value > 0) {
-			// existing match first
-			for (i = 0; i < psMinMaxCount; i++) {
-				if ((psMicroMin[i] <= value) && (value <= psMicroMax[i])) {
-					psixCount[i][psixPulseSpace]++;
-					if (j == 0) {
-						psixCount[i][psixPulse]++;
-					}
-					else {
-						psixCount[i][psixSpace]++;
-					}
-					if (ULONG_MAX - value > psMicroSum[i]) {
-						psMicroSum[i] += value;
-						psMicroSumCount[i] += 1;
-					}
-					break;
-				}
+			byte bin = psLogBin(value);
+			i = psBinSlotGet(bin);
+			if (i != PS_NOSLOT) { // existing bin
+				psBucketAdd(i, value, (j == 0) ? psixPulse : psixSpace);
 			}
-			if (i >= psMinMaxCount) { // no existing match check within tolerance
-				// Either a new length or just outside the current boundaries of a current value
-				uint k;
-				uint offBy = value;
-				// this still sux, occasional spikes give new index. 90% Compensated by data/gap split and value merging
-				// uint tolerance = (value < 500) ? 400 : (value < 1000) ? 200 : ((value < 2000) ? 400 : ((value < 5000) ? 600 : 1000));
-				// 20180916 was:
-				//uint tolerance = (value < 400) ? 300 : (value < 800) ? 400 : (value < 1200) ? 200 : ((value < 2000) ? 400 : ((value < 5000) ? 600 : 2000));
-				uint tolerance = (value < 1000) ? 150 : (value < 2000) ? 200 : (value < 3000) ? 300 : ((value < 4000) ? 400 : ((value < 5000) ? 600 : 2000));
-				for (k = 0; k < psMinMaxCount; k++) { // determine closest interval
-					uint offByi = value;
-					if ((value > psMicroMax[k]) && (value <= psMicroMin[k] + tolerance)) { // new max
-						offByi = value - psMicroMax[k];
-						if (offByi < offBy) {
-							i = k;
-							offBy = offByi;
-						}
-					}
-					else if ((value < psMicroMin[k]) && (value + tolerance >= psMicroMax[k])) { // new min?
-						offByi = psMicroMin[k] - value;
-						if (offByi < offBy) {
-							i = k;
-							offBy = offByi;
-						}
-					}
-				}
-				if (i < psMinMaxCount) { // existing match
-					if (value < psMicroMin[i]) { // new min
-						psMicroMin[i] = value;
-					}
-					else if (value > psMicroMax[i]) { // new max
-						psMicroMax[i] = value;
-					}
-					if ((ULONG_MAX - value) > psMicroSum[i]) {
-						psMicroSum[i] += value;
-						psMicroSumCount[i] += 1;
-					}
-					if (j == 0) {
-						psixCount[i][psixPulse]++;
-					}
-					else {
-						psixCount[i][psixSpace]++;
-					}
-					psixCount[i][psixPulseSpace]++;
-				}
-				else {
-					i = psMinMaxCount; // no match
-				}
+			else if (psMinMaxCount < PS_MICRO_ELEMENTS) { // new bin
+				i = psMinMaxCount++;
+				psBinSlotSet(bin, i);
+				psBucketNew(i, value, (j == 0) ? psixPulse : psixSpace);
 			}
-			if (i >= psMinMaxCount && i < PSI_OVERFLOW) { // new value
-				if (i < PS_MICRO_ELEMENTS) {
-					psMinMaxCount++;
-					psMicroMin[i] = value;
-					psMicroMax[i] = value;
-					psMicroSum[i] = value;
-					psMicroSumCount[i] = 1;
-					if (j == 0) {
-						psixCount[i][psixPulse] = 1;
-						psixCount[i][psixSpace] = 0;
-					}
-					else {
-						psixCount[i][psixPulse] = 0;
-						psixCount[i][psixSpace] = 1;
-					}
-					psixCount[i][psixPulseSpace] = 1;
-				}
-				else {
-					i = PSI_OVERFLOW; // overflow
-				}
+			else if ((bin > 0) && (psBinSlotGet(bin - 1) != PS_NOSLOT)) { // full, share adjacent bin, lower first
+				i = psBinSlotGet(bin - 1);
+				psBinSlotSet(bin, i);
+				psBucketAdd(i, value, (j == 0) ? psixPulse : psixSpace);
 			}
-		}
-		else {
-			i = PSI_OVERFLOW; //invalid data
+			else if ((bin + 1 < PS_LOG_BINS) && (psBinSlotGet(bin + 1) != PS_NOSLOT)) {
+				i = psBinSlotGet(bin + 1);
+				psBinSlotSet(bin, i);
+				psBucketAdd(i, value, (j == 0) ? psixPulse : psixSpace);
+			}
+			// else PSI_OVERFLOW, stats untouched
 		}
 		//psNibble = psPulseSpaceNibble(psNibble, i);
 		psNibble = ((psNibble & 0x0F) << 4) | (i & 0x0F);
@@ -711,6 +1320,240 @@ static byte psNibbleIndex(uint pulse, uint space) {
 #define SIGNAL_TIMEOUT_RF      EDGE_TIMEOUT
 #define SIGNAL_TIMEOUT_IR      10000 // Nodo Due Timing
 
+#ifndef MIN_PULSE
+#define MIN_PULSE 75
+#endif
+#ifndef MAX_PULSE
+#define MAX_PULSE 5000
+#endif
+#ifndef MIN_PSCOUNT
+#define MIN_PSCOUNT 48
+#endif
+#define PSI_RESET_COUNT 16 // psCount <= PSI_RESET_COUNT and invalid pulse: restart
+#define PSI_MIN_PS 75 // psiAddPS() drops shorter pulse/space
+
+/*
+ * PSI_NOISE: tune MIN_PULSE, MAX_PULSE and the reset count at runtime, per channel (RF/IR)
+ *
+ * Cheap receivers without AGC squelch give a constant stream of noise when idle.
+ * Pulses of discarded fragments and pulses shorter than minPulse go into a histogram (32 us bins),
+ * minPulse follows the PSI_NOISE_PERCENT percentile, the reset count follows the fragment lengths.
+ * maxPulse follows the longest pulse of good captures and is back at MAX_PULSE after a good capture with a longer pulse.
+ * EDGE_TIMEOUT stays: a longer gap can not be told from the end of a capture.
+ * Histograms are halved when a bin is full so old noise fades, limits only move 1/4 per tune.
+ * psiNoiseCalibrate(true) treats everything as noise, e.g. with no transmitter around.
+ */
+//#define PSI_NOISE	// or define before #include
+#ifdef PSI_NOISE
+#define PSI_NOISE_BIN_SHIFT 5	// 32 us
+#define PSI_NOISE_BINS 8	// last bin >= 224 us, above PSI_MIN_PULSE_HI
+#define PSI_NOISE_FRAG_SHIFT 3	// 8 psCount
+#define PSI_NOISE_FRAG_BINS 8
+#define PSI_NOISE_PERCENT 90
+#define PSI_NOISE_MIN_SAMPLES 64
+#define PSI_NOISE_TUNE_MS 1000
+#define PSI_MIN_PULSE_LO PSI_MIN_PS
+#define PSI_MIN_PULSE_HI 150	// WS249 170, KAKU 275: keep below shortest known data pulse
+#define PSI_MAX_PULSE_LO 1000
+
+typedef struct {
+	uint minPulse;
+	uint maxPulse;
+	byte resetCount;
+	uint goodMinPulse; // good captures, 0 unknown
+	uint goodMaxPulse;
+	bool longPulse; // pulse between maxPulse and MAX_PULSE in this capture
+	byte pulseHist[PSI_NOISE_BINS];
+	byte fragHist[PSI_NOISE_FRAG_BINS];
+} psiNoiseFloor;
+psiNoiseFloor psiNoise[2] = { // RF, IR
+	{MIN_PULSE, MAX_PULSE, PSI_RESET_COUNT, 0, 0, false, {0}, {0}},
+	{MIN_PULSE, MAX_PULSE, PSI_RESET_COUNT, 0, 0, false, {0}, {0}}
+};
+bool psiNoiseCalibrating = false;
+
+#define psiNoiseChannel() (&psiNoise[(fIsRf) ? 0 : 1])
+#define psiMinPulse() (psiNoiseChannel()->minPulse)
+#define psiMaxPulse() (psiNoiseChannel()->maxPulse)
+#define psiEdgeTimeout() EDGE_TIMEOUT
+#define psiResetCount() (psiNoiseChannel()->resetCount)
+
+static void psiNoiseBin(byte *hist, byte bins, uint bin) {
+	if (bin >= bins) {
+		bin = bins - 1;
+	}
+	if (hist[bin] == UINT8_MAX) { // age
+		for (byte b = 0; b < bins; b++) {
+			hist[b] >>= 1;
+		}
+	}
+	hist[bin]++;
+}
+
+/*
+ *	psiNoisePulse
+ *
+ * Pulse rejected, safe in ISR.
+ * Too short is noise, too long but below MAX_PULSE is remembered for psiNoiseGood():
+ * maxPulse may have shrunk too far for this device, noise fragments forget it in psiNoiseFragment()
+ */
+static void psiNoisePulse(uint pulse_dur) {
+	psiNoiseFloor *n = psiNoiseChannel();
+	if (pulse_dur <= n->minPulse) {
+		psiNoiseBin(n->pulseHist, PSI_NOISE_BINS, pulse_dur >> PSI_NOISE_BIN_SHIFT);
+	}
+	else if (pulse_dur < MAX_PULSE) {
+		n->longPulse = true;
+	}
+}
+
+/*
+ *	psiNoiseFragment
+ *
+ * Current psBuckets/psCount are noise, no division so safe in ISR for short fragments
+ */
+static void psiNoiseFragment(void) {
+	psiNoiseFloor *n = psiNoiseChannel();
+	psiNoiseBin(n->fragHist, PSI_NOISE_FRAG_BINS, psCount >> PSI_NOISE_FRAG_SHIFT);
+	n->longPulse = false;
+	for (byte i = 0; i < psMinMaxCount; i++) {
+		for (uint c = psBuckets[i].count[psixPulse]; c > 0; c--) {
+			psiNoiseBin(n->pulseHist, PSI_NOISE_BINS, psBuckets[i].ref >> PSI_NOISE_BIN_SHIFT); // first value, no division
+		}
+	}
+}
+
+/*
+ *	psiNoiseGood
+ *
+ * Record timing range of a good capture, old extremes decay 1/16 per capture.
+ * A good capture with pulses rejected as too long puts maxPulse back at MAX_PULSE.
+ */
+static void psiNoiseGood(void) {
+	psiNoiseFloor *n = psiNoiseChannel();
+	uint minPulse = UINT_MAX;
+	uint maxPulse = 0;
+	for (byte i = 0; i < psMinMaxCount; i++) {
+		if (psBuckets[i].count[psixPulse]) {
+			minPulse = min(minPulse, psMicroMin(i));
+			maxPulse = max(maxPulse, psMicroMax(i));
+		}
+	}
+	n->goodMinPulse = (n->goodMinPulse) ? min((uint)(n->goodMinPulse + n->goodMinPulse / 16), minPulse) : minPulse;
+	n->goodMaxPulse = max((uint)(n->goodMaxPulse - n->goodMaxPulse / 16), maxPulse);
+	if (n->longPulse) {
+		n->goodMaxPulse = 0;
+		n->longPulse = false;
+		noInterrupts(); // ISR reads maxPulse
+		n->maxPulse = MAX_PULSE;
+		interrupts();
+	}
+}
+
+/*
+ * Upper edge of the bin containing the PSI_NOISE_PERCENT percentile, 0 if too few samples
+ */
+static uint psiNoisePercentile(const byte *hist, byte bins, byte shift) {
+	uint total = 0;
+	for (byte b = 0; b < bins; b++) {
+		total += hist[b];
+	}
+	if (total < PSI_NOISE_MIN_SAMPLES) {
+		return 0;
+	}
+	uint cum = 0;
+	for (byte b = 0; b < bins; b++) {
+		cum += hist[b];
+		if ((ulong)cum * 100 >= (ulong)total * PSI_NOISE_PERCENT) {
+			return (uint)(b + 1) << shift;
+		}
+	}
+	return (uint)bins << shift;
+}
+
+static uint psiNoiseClamp(ulong value, uint lo, uint hi) {
+	return (value < lo) ? lo : ((value > hi) ? hi : (uint)value);
+}
+
+// move 1/4 to target
+static uint psiNoiseStep(uint value, uint target) {
+	return (target > value) ? value + (target - value + 3) / 4 : value - (value - target + 3) / 4;
+}
+
+/*
+ *	psiNoiseTune
+ *
+ * Recompute the limits of a channel, not in ISR
+ */
+static void psiNoiseTune(psiNoiseFloor *n) {
+	uint minPulse = n->minPulse;
+	uint minPulseHi = PSI_MIN_PULSE_HI;
+	uint noisePulse = psiNoisePercentile(n->pulseHist, PSI_NOISE_BINS, PSI_NOISE_BIN_SHIFT);
+	if (n->goodMinPulse) {
+		minPulseHi = min(minPulseHi, (uint)(n->goodMinPulse * 3 / 4));
+	}
+	if (noisePulse) {
+		minPulse = psiNoiseStep(minPulse, psiNoiseClamp(noisePulse, PSI_MIN_PULSE_LO, max(minPulseHi, (uint)PSI_MIN_PULSE_LO)));
+	}
+	uint maxPulse = psiNoiseStep(n->maxPulse,
+		(n->goodMaxPulse) ? psiNoiseClamp((ulong)n->goodMaxPulse * 2, PSI_MAX_PULSE_LO, MAX_PULSE) : MAX_PULSE);
+	// lower edge of the bin: fragments of resetCount come from resets and must not push it up
+	uint fragLen = psiNoisePercentile(n->fragHist, PSI_NOISE_FRAG_BINS, PSI_NOISE_FRAG_SHIFT);
+	byte resetCount = (fragLen) ? psiNoiseStep(n->resetCount,
+		psiNoiseClamp(fragLen - (1 << PSI_NOISE_FRAG_SHIFT), PSI_RESET_COUNT, MIN_PSCOUNT - 1)) : n->resetCount;
+
+	noInterrupts(); // ISR reads these
+	n->minPulse = minPulse;
+	n->maxPulse = maxPulse;
+	n->resetCount = resetCount;
+	interrupts();
+}
+
+void psiNoisePrint(void) {
+	for (byte ch = 0; ch < NRELEMENTS(psiNoise); ch++) {
+		psiNoiseFloor *n = &psiNoise[ch];
+		Serial.print((ch == 0) ? F("RF noise min ") : F("IR noise min "));
+		Serial.print(n->minPulse, DEC);
+		psiPrintComma(n->maxPulse, ' ', 1);
+		psiPrintComma(n->resetCount, '#', 1);
+		Serial.print(F(" hist"));
+		for (byte b = 0; b < PSI_NOISE_BINS; b++) {
+			psiPrintComma(n->pulseHist[b], ' ', 1);
+		}
+		Serial.println();
+	}
+}
+
+void psiNoiseCalibrate(bool fCalibrate) {
+	psiNoiseCalibrating = fCalibrate;
+	if (!fCalibrate) {
+		psiNoiseTune(&psiNoise[0]);
+		psiNoiseTune(&psiNoise[1]);
+		psiNoisePrint();
+	}
+}
+
+/*
+ *	psiNoiseTrack
+ *
+ * Call from loop(), tunes every PSI_NOISE_TUNE_MS
+ */
+void psiNoiseTrack(void) {
+	static uint32_t lastTune = 0;
+	uint32_t now = millis();
+	if (now - lastTune >= PSI_NOISE_TUNE_MS) {
+		lastTune = now;
+		psiNoiseTune(&psiNoise[0]);
+		psiNoiseTune(&psiNoise[1]);
+	}
+}
+#else
+#define psiMinPulse() MIN_PULSE
+#define psiMaxPulse() MAX_PULSE
+#define psiEdgeTimeout() EDGE_TIMEOUT
+#define psiResetCount() PSI_RESET_COUNT
+#endif
+
 /*
  * return micros psCount should not increase
  * to assume end of signal
@@ -722,20 +1565,26 @@ uint psiNoChangeTimeout(void){
 		return (fIsRf) ? SIGNAL_TIMEOUT_RF : SIGNAL_TIMEOUT_IR;
 	}
 #if 0
-	max = psMicroMax[0];
+	max = psMicroMax(0);
 	for (byte i = 1; i < psMinMaxCount; i++) {
-		if (psMicroMax[i] > max) {
-			max = psMicroMax[i];
+		if (psMicroMax(i) > max) {
+			max = psMicroMax(i);
 		}
 	}
 	return max * 32;
 #else
-	return EDGE_TIMEOUT;
+	return psiEdgeTimeout();
 #endif
 }
 
 //#include "analysepacket.h"
 static void psiFinish() {
+#ifdef PSI_NOISE
+	if (psiNoiseCalibrating) {
+		psiNoiseFragment();
+	}
+	else
+#endif
 	if ((psCount > 48 && fIsRf) || (psCount > 16 && !fIsRf)) {
 		uint32_t now = millis();
 		uint32_t nowm = micros();
@@ -747,24 +1596,38 @@ static void psiFinish() {
 			//Serial.println();
 
 			psiSortMicroMinMax();
-#ifdef PS_MERGE
-#ifdef PS_MERGE_DEBUG
-			if (fIsRf) {
-				psiPrint();
-			}
-#endif
-			if (fIsRf) {
-				psiMergeMicroMinMax();
-			}
+#ifdef PS_PROTOCOLS
+			if (psiMatchProtocol() == PSI_NOPROTOCOL)
 #endif
 			psiPrint();
+#ifdef PSI_NOISE
+			psiNoiseGood();
+#endif
 			lastSignal = millis();
 		}
 	}
+#ifdef PSI_NOISE
+	else if (psCount > 0) {
+		psiNoiseFragment();
+	}
+#endif
 	psCount = 0;
 	psiInit();
 }
 
+/*
+ * psiResetNoise
+ *
+ * Invalid pulse at the start of a capture (psCount <= psiResetCount()): discard as noise, safe in ISR
+ */
+void psiResetNoise(void) {
+#ifdef PSI_NOISE
+	psiNoiseFragment();
+#endif
+	psCount = 0; // reset
+	psiInit();
+}
+
 /*
  * psiAddPS
  *
@@ -777,7 +1640,7 @@ bool psiAddPS(uint16_t pulse_dur, uint8_t signal, uint8_t rssi) {
 	static uint firstPulseDur = 0;
 	static uint firstSpaceDur = 0;
 	if (pulse_dur > 1) {
-		if ((pulse_dur > 75) && (pulse_dur < EDGE_TIMEOUT)){
+		if ((pulse_dur > PSI_MIN_PS) && (pulse_dur < psiEdgeTimeout())){
 			if (psCount == 0) {
 				startSignal = millis();
 				startSignalm = micros();